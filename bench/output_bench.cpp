@@ -0,0 +1,141 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "output.h"
+
+// utils.cpp
+void print_rtt_summary(const std::vector<double> &rtts, const std::string& location);
+
+// multi-target runs produce hundreds of thousands of hops per second, keep well above that
+constexpr double MIN_RECORDS_PER_SEC = 500000.0;
+
+struct SyntheticHop {
+    std::string target;
+    int ttl;
+    std::string hop_ip;
+    std::vector<double> rtts;
+    std::string location;
+    bool destination_reached;
+};
+
+// deterministic mix of answered, partially answered and silent hops
+static std::vector<SyntheticHop> make_hops(int n) {
+    const char *targets[] = {"google.com", "cloudflare.com", "example.org", "nus.edu.sg"};
+    const char *locations[] = {
+        "(Mountain View, California, United States, Google LLC)",
+        "(Singapore, Central Singapore, Singapore, Amazon.com, Inc.)",
+        "(Montreal, Quebec, Canada, Google LLC)",
+        "(Unknown, Local Router)",
+    };
+    std::vector<SyntheticHop> hops;
+    hops.reserve(n);
+    uint32_t seed = 12345;
+    auto next = [&seed] { seed = seed * 1103515245 + 12345; return seed >> 8; };
+    for (int i = 0; i < n; ++i) {
+        SyntheticHop h;
+        h.target = targets[i % 4];
+        h.ttl = i % 30 + 1;
+        bool silent = next() % 8 == 0;
+        if (!silent) {
+            uint32_t ip = next();
+            h.hop_ip = std::to_string(ip >> 24 & 0xff) + "." + std::to_string(ip >> 16 & 0xff) + "." +
+                       std::to_string(ip >> 8 & 0xff) + "." + std::to_string(ip & 0xff);
+            h.location = locations[next() % 4];
+        }
+        for (int p = 0; p < 3; ++p) {
+            bool lost = silent || next() % 16 == 0;
+            h.rtts.push_back(lost ? -1.0 : (double)(next() % 200000) / 1000.0);
+        }
+        h.destination_reached = h.ttl == 30;
+        hops.push_back(std::move(h));
+    }
+    return hops;
+}
+
+// the per-hop text path from main.cpp, unchanged
+static void write_text(const SyntheticHop &h) {
+    std::cout << std::setw(4) << h.ttl;
+    if (h.hop_ip.empty()) {
+        std::cout << std::setw(20) << "*";
+    } else {
+        std::cout << std::setw(20) << h.hop_ip;
+    }
+    print_rtt_summary(h.rtts, h.location);
+    if (h.destination_reached) {
+        std::cout << "   (DEST)";
+    }
+    std::cout << "\n";
+}
+
+static double bench_text(const std::vector<SyntheticHop> &hops) {
+    std::cout << std::left;
+    uint64_t start = metrics_now_ns();
+    for (const auto &h : hops) write_text(h);
+    std::cout.flush();
+    return (double)(metrics_now_ns() - start) / 1e9;
+}
+
+static double bench_writer(const std::vector<SyntheticHop> &hops, OutputFormat format, int fd) {
+    uint64_t start = metrics_now_ns();
+    {
+        RecordWriter writer(fd, format);
+        for (const auto &h : hops) {
+            HopRecord rec;
+            rec.target = h.target;
+            rec.ttl = h.ttl;
+            rec.hop_ip = h.hop_ip;
+            rec.rtts = h.rtts;
+            rec.location = h.location;
+            rec.destination_reached = h.destination_reached;
+            writer.write_hop(rec);
+        }
+    }
+    return (double)(metrics_now_ns() - start) / 1e9;
+}
+
+int main() {
+    constexpr int N = 1000000;
+    constexpr int ROUNDS = 3;
+
+    std::vector<SyntheticHop> hops = make_hops(N);
+
+    // all three sinks go to /dev/null so only formatting and buffering are measured;
+    // results are reported on the original stdout
+    int report_fd = dup(STDOUT_FILENO);
+    FILE *report = fdopen(report_fd, "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (report == nullptr || null_fd < 0 || freopen("/dev/null", "w", stdout) == nullptr) {
+        perror("redirecting output");
+        return 1;
+    }
+
+    double text_s = 1e18, jsonl_s = 1e18, binary_s = 1e18;
+    for (int r = 0; r < ROUNDS; ++r) {
+        text_s = std::min(text_s, bench_text(hops));
+        jsonl_s = std::min(jsonl_s, bench_writer(hops, OutputFormat::Jsonl, null_fd));
+        binary_s = std::min(binary_s, bench_writer(hops, OutputFormat::Binary, null_fd));
+    }
+    close(null_fd);
+
+    double text_rps = N / text_s, jsonl_rps = N / jsonl_s, binary_rps = N / binary_s;
+    fprintf(report, "%d hop records, best of %d\n", N, ROUNDS);
+    fprintf(report, "text (iostream):  %12.0f records/s\n", text_rps);
+    fprintf(report, "jsonl (writer):   %12.0f records/s  (%.1fx text)\n", jsonl_rps, jsonl_rps / text_rps);
+    fprintf(report, "binary (writer):  %12.0f records/s  (%.1fx text)\n", binary_rps, binary_rps / text_rps);
+
+    if (jsonl_rps < MIN_RECORDS_PER_SEC || binary_rps < MIN_RECORDS_PER_SEC) {
+        fprintf(report, "FAIL: structured output below %.0f records/s\n", MIN_RECORDS_PER_SEC);
+        fclose(report);
+        return 1;
+    }
+    fprintf(report, "OK: structured output above %.0f records/s\n", MIN_RECORDS_PER_SEC);
+    fclose(report);
+    return 0;
+}
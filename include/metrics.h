@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <ostream>
+#include <string>
+
+// pipeline stages that get a latency histogram
+enum class Stage : int {
+    PacketBuild = 0,
+    Send,
+    Wait,
+    Receive,
+    Match,
+    Geolocation,
+    Output,
+    Count
+};
+
+// plain event counters (no latency attached)
+enum class Counter : int {
+    ProbesSent = 0,
+    ProbeTimeouts,
+    SendErrors,
+    SelectErrors,
+    RecvErrors,
+    MatchHit,
+    MatchMiss,
+    GeoCacheHit,
+    GeoCacheMiss,
+    GeoErrors,
+    HopsOutput,
+    Count
+};
+
+inline uint64_t metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// hot path: each thread writes only its own shard, no locks and no RMW atomics
+void metrics_record(Stage stage, uint64_t elapsed_ns);
+void metrics_count(Counter counter, uint64_t n = 1);
+
+// prometheus text exposition format (version 0.0.4) aggregated over all threads
+std::string metrics_render_prometheus();
+// human readable per-stage summary, printed once on exit
+void metrics_print_summary(std::ostream &os);
+
+// serve metrics_render_prometheus() on http://127.0.0.1:<port>/metrics from a background thread
+bool metrics_start_server(uint16_t port);
+void metrics_stop_server();
+
+// records the time from construction to destruction (or stop()) against a stage
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage) : stage_(stage), start_ns_(metrics_now_ns()) {}
+    ~StageTimer() { stop(); }
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    void stop() {
+        if (stopped_) return;
+        stopped_ = true;
+        metrics_record(stage_, metrics_now_ns() - start_ns_);
+    }
+
+private:
+    Stage stage_;
+    uint64_t start_ns_;
+    bool stopped_ = false;
+};
+
+// back-to-back stages: lap() charges the time since the previous lap (or construction)
+// to a stage, halving the clock reads compared to one StageTimer per stage
+class StageClock {
+public:
+    StageClock() : last_ns_(metrics_now_ns()) {}
+
+    void lap(Stage stage) {
+        uint64_t now = metrics_now_ns();
+        metrics_record(stage, now - last_ns_);
+        last_ns_ = now;
+    }
+
+    // restart from now without charging the elapsed time to any stage
+    void skip() {
+        last_ns_ = metrics_now_ns();
+    }
+
+private:
+    uint64_t last_ns_;
+};
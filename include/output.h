@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+enum class OutputFormat {
+    Text,    // human readable table (default)
+    Jsonl,   // one JSON object per hop per line
+    Binary   // length-prefixed records, see below
+};
+
+// "text", "jsonl" or "binary"
+bool parse_output_format(const char *name, OutputFormat &out);
+
+// one traced hop; all fields are borrowed, nothing is copied
+struct HopRecord {
+    std::string_view target;        // destination as given on the command line
+    int ttl = 0;
+    std::string_view hop_ip;        // empty if no responder
+    std::span<const double> rtts;   // ms, -1 for a timed out probe
+    std::string_view location;
+    bool destination_reached = false;
+};
+
+// binary record layout, all integers little-endian:
+//   u32 body_len                 bytes following this field
+//   u8  version                  BINARY_RECORD_VERSION
+//   u8  ttl
+//   u8  flags                    bit 0: destination reached, bit 1: responder known
+//   u8  rtt_count
+//   u32 responder                IPv4 in network byte order, 0 if unknown
+//   u32 rtt_us[rtt_count]        0xffffffff for a timed out probe
+//   u16 target_len,   target bytes
+//   u16 location_len, location bytes
+constexpr uint8_t BINARY_RECORD_VERSION = 1;
+constexpr uint32_t BINARY_RTT_TIMEOUT = 0xffffffff;
+
+// formats hop records straight into one large buffer with std::to_chars and hands it to
+// write(2) only when full or on flush(). no allocation after construction unless a
+// single record is larger than the whole buffer
+class RecordWriter {
+public:
+    RecordWriter(int fd, OutputFormat format, size_t buffer_size = 1 << 20);
+    ~RecordWriter();
+    RecordWriter(const RecordWriter &) = delete;
+    RecordWriter &operator=(const RecordWriter &) = delete;
+
+    void write_hop(const HopRecord &hop);
+    bool flush();
+
+private:
+    void reserve(size_t n);
+    void write_jsonl(const HopRecord &hop);
+    void write_binary(const HopRecord &hop);
+
+    int fd_;
+    OutputFormat format_;
+    std::vector<char> buf_;
+    size_t len_ = 0;
+};
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <curl/curl.h>
+#include "metrics.h"
 
 // callback for libcurl to write response into a std::string
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
@@ -12,6 +13,7 @@ size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* out
 std::string get_geolocation(const std::string& query) {
     CURL* curl = curl_easy_init();
     if (!curl) {
+        metrics_count(Counter::GeoErrors);
         std::cerr << "Failed to initialize libcurl\n";
         return "";
     }
@@ -27,6 +29,7 @@ std::string get_geolocation(const std::string& query) {
 
     CURLcode res = curl_easy_perform(curl);
     if (res != CURLE_OK) {
+        metrics_count(Counter::GeoErrors);
         std::cerr << "curl_easy_perform() failed: "
                   << curl_easy_strerror(res) << std::endl;
         curl_easy_cleanup(curl);
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstring>
 #include <cerrno>    
+#include <cstdlib>
 #include <ctime>     
 #include <sys/time.h>
 #include <fcntl.h> 
@@ -15,6 +16,11 @@
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <iomanip>
+#include <string>
+#include <unordered_map>
+#include <optional>
+#include "metrics.h"
+#include "output.h"
 
 // net_helpers.cpp
 bool resolve_hostname_ipv4(const char *hostname, std::string &out_ipv4);
@@ -36,9 +42,36 @@ std::string get_geolocation(const std::string& query);
 int main(int argc, char** argv) {
     const char* dst_arg;
     uint16_t dst_port;
+    int metrics_port = 0;
+    OutputFormat format = OutputFormat::Text;
+
+    // pull out --options, everything else stays positional
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (i > 0 && strncmp(argv[i], "--metrics-port=", 15) == 0) {
+            const char *value = argv[i] + 15;
+            char *end = nullptr;
+            errno = 0;
+            long port = strtol(value, &end, 10);
+            if (errno != 0 || end == value || *end != '\0' || port < 1 || port > 65535) {
+                std::cerr << "Invalid metrics port: " << value << " (expected 1-65535)\n";
+                return 1;
+            }
+            metrics_port = (int)port;
+        } else if (i > 0 && strncmp(argv[i], "--format=", 9) == 0) {
+            if (!parse_output_format(argv[i] + 9, format)) {
+                std::cerr << "Unknown output format: " << argv[i] + 9 << " (expected text, jsonl or binary)\n";
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    argc = (int)args.size();
+    argv = args.data();
 
     if (argc != 2 && argc != 3) {
-        std::cout <<  "Usage: ./geotracer <HOSTNAME> <PORT=443>\n";
+        std::cout <<  "Usage: ./geotracer [--format=text|jsonl|binary] [--metrics-port=PORT] <HOSTNAME> <PORT=443>\n";
         return 1;
     }
 
@@ -50,26 +83,29 @@ int main(int argc, char** argv) {
         dst_port = std::stoi(argv[2]);
     }
 
+    // structured formats own stdout, so progress messages move to stderr
+    std::ostream &info = (format == OutputFormat::Text) ? std::cout : std::cerr;
+
     std::string dst_ip;
     if (!resolve_hostname_ipv4(dst_arg, dst_ip)) {
         std::cerr << "Cannot resolve destination\n";
         return 1;
     }
-    std::cout << "Resolved dst: " << dst_arg << " -> " << dst_ip << "\n";
+    info << "Resolved dst: " << dst_arg << " -> " << dst_ip << "\n";
 
     std::string src_ip;
     if (!get_local_ip_for_dest(dst_ip.c_str(), src_ip)) {
         std::cerr << "Cannot determine local outbound IP for " << dst_ip << "\n";
         return 1;
     }
-    std::cout << "Using local source IP: " << src_ip << "\n";
+    info << "Using local source IP: " << src_ip << "\n";
 
     uint16_t src_port;
     if (!get_ephemeral_port(src_port)) {
         std::cerr << "Cannot obtain ephemeral source port\n";
         return 1;
     }
-    std::cout << "Using ephemeral source port: " << src_port << "\n";
+    info << "Using ephemeral source port: " << src_port << "\n";
 
     int max_hops = (argc >= 6) ? std::stoi(argv[5]) : 30;
     int timeout_ms = (argc >= 7) ? std::stoi(argv[6]) : 1000; // per probe timeout
@@ -102,10 +138,22 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    std::cout << "Probing " << dst_ip << " from " << src_ip << " (src_port=" << src_port << ", dst_port=" << dst_port << ")\n";
-    std::cout << "Max hops: " << max_hops << ", timeout per probe: " << timeout_ms << " ms\n\n";
-    std::cout << std::left << std::setw(4) << "Hop" << std::setw(20) << "Responder IP" << " RTT summary (min/avg/max)\n";
-    std::cout << std::string(70, '-') << "\n";
+    if (metrics_port > 0) {
+        if (metrics_start_server((uint16_t)metrics_port)) {
+            std::cerr << "Serving metrics on http://127.0.0.1:" << metrics_port << "/metrics\n";
+        }
+    }
+
+    info << "Probing " << dst_ip << " from " << src_ip << " (src_port=" << src_port << ", dst_port=" << dst_port << ")\n";
+    info << "Max hops: " << max_hops << ", timeout per probe: " << timeout_ms << " ms\n\n";
+    if (format == OutputFormat::Text) {
+        std::cout << std::left << std::setw(4) << "Hop" << std::setw(20) << "Responder IP" << " RTT summary (min/avg/max)\n";
+        std::cout << std::string(70, '-') << "\n";
+    }
+
+    // the text table goes through std::cout, only structured formats need the writer's buffer
+    std::optional<RecordWriter> writer;
+    if (format != OutputFormat::Text) writer.emplace(STDOUT_FILENO, format);
 
     bool overall_destination_reached = false;
     int hop_count = 0;
@@ -131,22 +179,42 @@ int main(int argc, char** argv) {
         std::string location = "";
         if (hop_ip != "-" && hop_ip != "*" && !hop_ip.empty()) {
             if (geo_cache.count(hop_ip) == 0) {
+                metrics_count(Counter::GeoCacheMiss);
+                StageTimer geo_timer(Stage::Geolocation);
                 geo_cache[hop_ip] = get_geolocation(hop_ip); 
+            } else {
+                metrics_count(Counter::GeoCacheHit);
             }
             location = geo_cache[hop_ip];         
         }
 
-        std::cout << std::setw(4) << ttl;
-        if (hop_ip == "-" || hop_ip.empty()) {
-            std::cout << std::setw(20) << "*";
+        StageTimer output_timer(Stage::Output);
+        if (format == OutputFormat::Text) {
+            std::cout << std::setw(4) << ttl;
+            if (hop_ip == "-" || hop_ip.empty()) {
+                std::cout << std::setw(20) << "*";
+            } else {
+                std::cout << std::setw(20) << hop_ip;
+            }
+            print_rtt_summary(rtts, location);
+            if (destination_reached) {
+                std::cout << "   (DEST)";
+            }
+            std::cout << "\n";
         } else {
-            std::cout << std::setw(20) << hop_ip;
-        }
-        print_rtt_summary(rtts, location);
-        if (destination_reached) {
-            std::cout << "   (DEST)";
+            HopRecord hop;
+            hop.target = dst_arg;
+            hop.ttl = ttl;
+            if (hop_ip != "-") hop.hop_ip = hop_ip;
+            hop.rtts = rtts;
+            hop.location = location;
+            hop.destination_reached = destination_reached;
+            writer->write_hop(hop);
+            // hops arrive seconds apart, push each one out so consumers see it live
+            writer->flush();
         }
-        std::cout << "\n";
+        output_timer.stop();
+        metrics_count(Counter::HopsOutput);
 
         hop_count = ttl;
         if (destination_reached) {
@@ -155,15 +223,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    std::cout << "\nDone. ";
+    info << "\nDone. ";
     if (overall_destination_reached) {
-        std::cout << "Destination reached in " << hop_count << " hops.\n";
+        info << "Destination reached in " << hop_count << " hops.\n";
     } else {
-        std::cout << "Destination not reached (max hops " << max_hops << ")\n";
+        info << "Destination not reached (max hops " << max_hops << ")\n";
     }
 
     close(send_tcp_sock);
     close(recv_icmp_sock);
     close(recv_tcp_sock);
+
+    metrics_stop_server();
+    metrics_print_summary(std::cerr);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "metrics.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int NUM_STAGES = (int)Stage::Count;
+constexpr int NUM_COUNTERS = (int)Counter::Count;
+
+// bucket k holds samples <= 1us * 2^k, the last bucket is +Inf (1us .. ~8.4s)
+constexpr int NUM_BUCKETS = 24;
+
+const char *STAGE_NAMES[NUM_STAGES] = {
+    "packet_build", "send", "wait", "receive", "match", "geolocation", "output"
+};
+
+const char *COUNTER_NAMES[NUM_COUNTERS] = {
+    "probes_sent", "probe_timeouts", "send_errors", "select_errors", "recv_errors",
+    "match_hit", "match_miss", "geo_cache_hit", "geo_cache_miss", "geo_errors", "hops_output"
+};
+
+struct Histogram {
+    std::atomic<uint64_t> buckets[NUM_BUCKETS + 1];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+// one shard per thread; only the owning thread writes, readers just load.
+// single writer means a relaxed load + store is enough, no lock prefix needed
+struct Shard {
+    Histogram stages[NUM_STAGES] = {};
+    std::atomic<uint64_t> counters[NUM_COUNTERS] = {};
+};
+
+inline void bump(std::atomic<uint64_t> &a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// shards are never freed so a reader can still sum the values of threads that exited
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<Shard>> registry;
+
+Shard *register_shard() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(std::make_unique<Shard>());
+    return registry.back().get();
+}
+
+inline Shard &local_shard() {
+    thread_local Shard *shard = register_shard();
+    return *shard;
+}
+
+inline int bucket_index(uint64_t ns) {
+    uint64_t us = (ns + 999) / 1000;
+    if (us <= 1) return 0;
+    int k = std::bit_width(us - 1);
+    return k < NUM_BUCKETS ? k : NUM_BUCKETS;
+}
+
+double bucket_upper_seconds(int k) {
+    return (double)(1ull << k) * 1e-6;
+}
+
+// point-in-time sum over all shards
+struct Snapshot {
+    uint64_t buckets[NUM_STAGES][NUM_BUCKETS + 1] = {};
+    uint64_t count[NUM_STAGES] = {};
+    uint64_t sum_ns[NUM_STAGES] = {};
+    uint64_t max_ns[NUM_STAGES] = {};
+    uint64_t counters[NUM_COUNTERS] = {};
+};
+
+void take_snapshot(Snapshot &snap) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &shard : registry) {
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            const Histogram &h = shard->stages[s];
+            for (int b = 0; b <= NUM_BUCKETS; ++b) {
+                snap.buckets[s][b] += h.buckets[b].load(std::memory_order_relaxed);
+            }
+            snap.count[s] += h.count.load(std::memory_order_relaxed);
+            snap.sum_ns[s] += h.sum_ns.load(std::memory_order_relaxed);
+            snap.max_ns[s] = std::max(snap.max_ns[s], h.max_ns.load(std::memory_order_relaxed));
+        }
+        for (int c = 0; c < NUM_COUNTERS; ++c) {
+            snap.counters[c] += shard->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// upper bound (ms) of the bucket containing quantile q, capped at the observed max
+double quantile_ms(const Snapshot &snap, int s, double q) {
+    uint64_t total = snap.count[s];
+    if (total == 0) return 0.0;
+    uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+        seen += snap.buckets[s][b];
+        if (seen >= rank) return std::min(bucket_upper_seconds(b) * 1e3, (double)snap.max_ns[s] / 1e6);
+    }
+    return (double)snap.max_ns[s] / 1e6;
+}
+
+std::atomic<bool> server_running{false};
+std::thread server_thread;
+int server_fd = -1;
+
+// true for "GET /metrics", optionally followed by a query string
+bool is_metrics_request(const char *req, size_t len) {
+    static const char PREFIX[] = "GET /metrics";
+    size_t plen = sizeof(PREFIX) - 1;
+    if (len <= plen || memcmp(req, PREFIX, plen) != 0) return false;
+    return req[plen] == ' ' || req[plen] == '?';
+}
+
+void handle_client(int client_fd) {
+    // only the request line matters, headers and body are ignored
+    char req[1024];
+    ssize_t n = recv(client_fd, req, sizeof(req), 0);
+    if (n <= 0) return;
+
+    std::string resp;
+    if (is_metrics_request(req, (size_t)n)) {
+        std::string body = metrics_render_prometheus();
+        resp = "HTTP/1.1 200 OK\r\n"
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Connection: close\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    } else {
+        resp = "HTTP/1.1 404 Not Found\r\n"
+               "Content-Type: text/plain\r\n"
+               "Connection: close\r\n"
+               "Content-Length: 10\r\n\r\nNot Found\n";
+    }
+
+    size_t off = 0;
+    while (off < resp.size()) {
+        ssize_t w = send(client_fd, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+}
+
+void server_loop() {
+    while (server_running.load(std::memory_order_relaxed)) {
+        struct pollfd pfd{server_fd, POLLIN, 0};
+        // wake up periodically so metrics_stop_server() does not block
+        int rv = poll(&pfd, 1, 200);
+        if (rv <= 0) continue;
+
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) continue;
+        struct timeval tv{1, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        handle_client(client_fd);
+        close(client_fd);
+    }
+}
+
+} // namespace
+
+void metrics_record(Stage stage, uint64_t elapsed_ns) {
+    Histogram &h = local_shard().stages[(int)stage];
+    bump(h.buckets[bucket_index(elapsed_ns)], 1);
+    bump(h.count, 1);
+    bump(h.sum_ns, elapsed_ns);
+    if (elapsed_ns > h.max_ns.load(std::memory_order_relaxed)) {
+        h.max_ns.store(elapsed_ns, std::memory_order_relaxed);
+    }
+}
+
+void metrics_count(Counter counter, uint64_t n) {
+    bump(local_shard().counters[(int)counter], n);
+}
+
+std::string metrics_render_prometheus() {
+    Snapshot snap;
+    take_snapshot(snap);
+
+    std::string out;
+    out.reserve(16384);
+    char line[512];
+
+    out += "# HELP geotracer_stage_duration_seconds Latency of each probe pipeline stage.\n";
+    out += "# TYPE geotracer_stage_duration_seconds histogram\n";
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            cumulative += snap.buckets[s][b];
+            snprintf(line, sizeof(line),
+                     "geotracer_stage_duration_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n",
+                     STAGE_NAMES[s], bucket_upper_seconds(b), (unsigned long long)cumulative);
+            out += line;
+        }
+        // +Inf and _count come from the same bucket loads so they can never fall below
+        // the last finite bucket, even while another thread is recording
+        cumulative += snap.buckets[s][NUM_BUCKETS];
+        snprintf(line, sizeof(line),
+                 "geotracer_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n"
+                 "geotracer_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n"
+                 "geotracer_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                 STAGE_NAMES[s], (unsigned long long)cumulative,
+                 STAGE_NAMES[s], (double)snap.sum_ns[s] / 1e9,
+                 STAGE_NAMES[s], (unsigned long long)cumulative);
+        out += line;
+    }
+
+    out += "# HELP geotracer_events_total Probe, match, geolocation cache and output events.\n";
+    out += "# TYPE geotracer_events_total counter\n";
+    for (int c = 0; c < NUM_COUNTERS; ++c) {
+        snprintf(line, sizeof(line), "geotracer_events_total{event=\"%s\"} %llu\n",
+                 COUNTER_NAMES[c], (unsigned long long)snap.counters[c]);
+        out += line;
+    }
+    return out;
+}
+
+void metrics_print_summary(std::ostream &os) {
+    Snapshot snap;
+    take_snapshot(snap);
+
+    std::ios::fmtflags flags = os.flags();
+    os << "\nMetrics summary\n";
+    os << std::left << std::setw(14) << "Stage" << std::right
+       << std::setw(10) << "count" << std::setw(12) << "avg ms"
+       << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms"
+       << std::setw(12) << "max ms" << "\n";
+    os << std::string(72, '-') << "\n";
+    os.setf(std::ios::fixed);
+    os << std::setprecision(3);
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        double avg = snap.count[s] ? (double)snap.sum_ns[s] / (double)snap.count[s] / 1e6 : 0.0;
+        os << std::left << std::setw(14) << STAGE_NAMES[s] << std::right
+           << std::setw(10) << snap.count[s]
+           << std::setw(12) << avg
+           << std::setw(12) << quantile_ms(snap, s, 0.50)
+           << std::setw(12) << quantile_ms(snap, s, 0.99)
+           << std::setw(12) << (double)snap.max_ns[s] / 1e6 << "\n";
+    }
+    os << "\n";
+    for (int c = 0; c < NUM_COUNTERS; ++c) {
+        os << std::left << std::setw(16) << COUNTER_NAMES[c] << std::right << snap.counters[c] << "\n";
+    }
+    os.flags(flags);
+}
+
+bool metrics_start_server(uint16_t port) {
+    if (server_running.load()) return true;
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        perror("socket(metrics)");
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    // local only: the endpoint is meant to be scraped by an agent on the same host
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind(metrics)");
+        close(server_fd);
+        server_fd = -1;
+        return false;
+    }
+    if (listen(server_fd, 16) < 0) {
+        perror("listen(metrics)");
+        close(server_fd);
+        server_fd = -1;
+        return false;
+    }
+
+    server_running.store(true);
+    server_thread = std::thread(server_loop);
+    return true;
+}
+
+void metrics_stop_server() {
+    if (!server_running.exchange(false)) return;
+    if (server_thread.joinable()) server_thread.join();
+    close(server_fd);
+    server_fd = -1;
+}
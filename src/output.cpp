@@ -0,0 +1,221 @@
+#include "output.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+bool parse_output_format(const char *name, OutputFormat &out) {
+    if (strcmp(name, "text") == 0) {
+        out = OutputFormat::Text;
+    } else if (strcmp(name, "jsonl") == 0) {
+        out = OutputFormat::Jsonl;
+    } else if (strcmp(name, "binary") == 0) {
+        out = OutputFormat::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// min/avg/max over answered probes, same rules as print_rtt_summary()
+struct RttStats {
+    int valid = 0;
+    double mn = 0, avg = 0, mx = 0;
+};
+
+RttStats rtt_stats(std::span<const double> rtts) {
+    RttStats st;
+    double sum = 0;
+    for (double v : rtts) {
+        if (v < 0) continue;
+        if (st.valid == 0 || v < st.mn) st.mn = v;
+        if (st.valid == 0 || v > st.mx) st.mx = v;
+        sum += v;
+        ++st.valid;
+    }
+    if (st.valid > 0) st.avg = sum / st.valid;
+    return st;
+}
+
+inline char *put(char *p, std::string_view s) {
+    memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+// ms with microsecond resolution; clamped so the text never exceeds 17 bytes
+inline char *put_ms(char *p, double ms) {
+    return std::to_chars(p, p + 32, std::min(ms, 1e12), std::chars_format::fixed, 3).ptr;
+}
+
+// JSON string body; worst case every byte becomes a 6 byte \u00XX escape
+char *put_json_string(char *p, std::string_view s) {
+    static const char HEX[] = "0123456789abcdef";
+    *p++ = '"';
+    for (char c : s) {
+        unsigned char u = (unsigned char)c;
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (u < 0x20) {
+            p = put(p, "\\u00");
+            *p++ = HEX[u >> 4];
+            *p++ = HEX[u & 0xf];
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    return p;
+}
+
+inline char *put_u8(char *p, uint8_t v) {
+    *p = (char)v;
+    return p + 1;
+}
+
+inline char *put_u16(char *p, uint16_t v) {
+    v = htole16(v);
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+inline char *put_u32(char *p, uint32_t v) {
+    v = htole32(v);
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+} // namespace
+
+RecordWriter::RecordWriter(int fd, OutputFormat format, size_t buffer_size)
+    : fd_(fd), format_(format), buf_(buffer_size) {}
+
+RecordWriter::~RecordWriter() {
+    flush();
+}
+
+bool RecordWriter::flush() {
+    size_t off = 0;
+    while (off < len_) {
+        ssize_t w = write(fd_, buf_.data() + off, len_ - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            perror("write in RecordWriter::flush");
+            len_ = 0;
+            return false;
+        }
+        off += (size_t)w;
+    }
+    len_ = 0;
+    return true;
+}
+
+// make room for n more bytes
+void RecordWriter::reserve(size_t n) {
+    if (buf_.size() - len_ >= n) return;
+    flush();
+    if (buf_.size() < n) buf_.resize(n);
+}
+
+void RecordWriter::write_hop(const HopRecord &hop) {
+    if (format_ == OutputFormat::Binary) {
+        write_binary(hop);
+    } else {
+        write_jsonl(hop);
+    }
+}
+
+void RecordWriter::write_jsonl(const HopRecord &hop) {
+    size_t strings = hop.target.size() + hop.hop_ip.size() + hop.location.size();
+    reserve(256 + 6 * strings + 40 * hop.rtts.size());
+
+    char *p = buf_.data() + len_;
+    p = put(p, "{\"target\":");
+    p = put_json_string(p, hop.target);
+    p = put(p, ",\"ttl\":");
+    p = std::to_chars(p, p + 16, hop.ttl).ptr;
+
+    p = put(p, ",\"ip\":");
+    if (hop.hop_ip.empty()) {
+        p = put(p, "null");
+    } else {
+        p = put_json_string(p, hop.hop_ip);
+    }
+
+    p = put(p, ",\"rtt_ms\":[");
+    for (size_t i = 0; i < hop.rtts.size(); ++i) {
+        if (i > 0) *p++ = ',';
+        if (hop.rtts[i] < 0) {
+            p = put(p, "null");
+        } else {
+            p = put_ms(p, hop.rtts[i]);
+        }
+    }
+    *p++ = ']';
+
+    RttStats st = rtt_stats(hop.rtts);
+    if (st.valid > 0) {
+        p = put(p, ",\"min_ms\":");
+        p = put_ms(p, st.mn);
+        p = put(p, ",\"avg_ms\":");
+        p = put_ms(p, st.avg);
+        p = put(p, ",\"max_ms\":");
+        p = put_ms(p, st.mx);
+    } else {
+        p = put(p, ",\"min_ms\":null,\"avg_ms\":null,\"max_ms\":null");
+    }
+
+    p = put(p, ",\"location\":");
+    p = put_json_string(p, hop.location);
+    p = put(p, hop.destination_reached ? ",\"dest\":true}\n" : ",\"dest\":false}\n");
+
+    len_ = p - buf_.data();
+}
+
+void RecordWriter::write_binary(const HopRecord &hop) {
+    // counts and lengths are clamped to what their fields can hold
+    size_t rtt_count = std::min<size_t>(hop.rtts.size(), 0xff);
+    std::string_view target = hop.target.substr(0, 0xffff);
+    std::string_view location = hop.location.substr(0, 0xffff);
+
+    uint32_t body_len = 4 + 4 + 4 * rtt_count + 2 + target.size() + 2 + location.size();
+    reserve(4 + body_len);
+
+    uint32_t responder = 0;
+    if (!hop.hop_ip.empty() && hop.hop_ip.size() < INET_ADDRSTRLEN) {
+        char ip_s[INET_ADDRSTRLEN];
+        memcpy(ip_s, hop.hop_ip.data(), hop.hop_ip.size());
+        ip_s[hop.hop_ip.size()] = '\0';
+        if (inet_pton(AF_INET, ip_s, &responder) != 1) responder = 0;
+    }
+
+    uint8_t flags = (hop.destination_reached ? 0x1 : 0) | (responder != 0 ? 0x2 : 0);
+
+    char *p = buf_.data() + len_;
+    p = put_u32(p, body_len);
+    p = put_u8(p, BINARY_RECORD_VERSION);
+    p = put_u8(p, (uint8_t)hop.ttl);
+    p = put_u8(p, flags);
+    p = put_u8(p, (uint8_t)rtt_count);
+    // already in network byte order, copied as is
+    memcpy(p, &responder, sizeof(responder));
+    p += sizeof(responder);
+    for (size_t i = 0; i < rtt_count; ++i) {
+        double ms = hop.rtts[i];
+        uint32_t us = ms < 0 ? BINARY_RTT_TIMEOUT : (uint32_t)std::min(ms * 1000.0 + 0.5, (double)(BINARY_RTT_TIMEOUT - 1));
+        p = put_u32(p, us);
+    }
+    p = put_u16(p, (uint16_t)target.size());
+    p = put(p, target);
+    p = put_u16(p, (uint16_t)location.size());
+    p = put(p, location);
+
+    len_ = p - buf_.data();
+}
@@ -16,6 +16,7 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include "metrics.h"
 
 // utils.cpp
 double timespec_diff_ms(const struct timespec &a, const struct timespec &b);
@@ -112,7 +113,10 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
 
     for (int probe_i = 0; probe_i < PROBES; ++probe_i) {
         char packet[4096];
+        // each lap covers the time since the previous one, so every stage costs one clock read
+        StageClock stage_clock;
         int pkt_len = create_tcp_syn_packet(src_ip, dst_ip, src_port, dst_port, (uint8_t)ttl, packet, sizeof(packet));
+        stage_clock.lap(Stage::PacketBuild);
         if (pkt_len < 0) {
             std::cerr << "create_tcp_syn_packet failed\n";
             return false;
@@ -129,13 +133,19 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
         inet_pton(AF_INET, dst_ip, &dst_addr.sin_addr);
 
         ssize_t sent = sendto(send_sock, packet, pkt_len, 0, (struct sockaddr*)&dst_addr, sizeof(dst_addr));
+        stage_clock.lap(Stage::Send);
         if (sent < 0) {
+            metrics_count(Counter::SendErrors);
             perror("sendto in probe_ttl");
+        } else {
+            metrics_count(Counter::ProbesSent);
         }
 
         // wait for reply(s) with select up to timeout_ms
         int remaining_ms = timeout_ms;
         bool probe_answered = false;
+        // set by either an ICMP or a TCP match; the probe only timed out if neither matched
+        bool got_reply = false;
         struct timespec start_time, current_time;
         clock_gettime(CLOCK_MONOTONIC, &start_time);
         
@@ -150,8 +160,15 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
             tv.tv_usec = (remaining_ms % 1000) * 1000;
 
             int rv = select(maxfd + 1, &rfds, nullptr, nullptr, &tv);
+            // once a reply matched, the rest of the timeout is not waiting for this probe
+            if (got_reply) {
+                stage_clock.skip();
+            } else {
+                stage_clock.lap(Stage::Wait);
+            }
             if (rv < 0) {
                 if (errno == EINTR) continue;
+                metrics_count(Counter::SelectErrors);
                 perror("select probe_ttl");
                 break;
             } else if (rv == 0) {
@@ -169,17 +186,23 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
                 sockaddr_in from{};
                 socklen_t fromlen = sizeof(from);
                 ssize_t len = recvfrom(recv_icmp_sock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
+                stage_clock.lap(Stage::Receive);
+                if (len < 0) metrics_count(Counter::RecvErrors);
                 if (len > 0) {
                     char from_s[INET_ADDRSTRLEN];
                     inet_ntop(AF_INET, &from.sin_addr, from_s, sizeof(from_s));
                     
                     // verify ICMP corresponds to our probe packet
-                    if (match_icmp_with_probe(buf, len, src_ip, dst_ip, src_port, dst_port)) {
+                    bool matched = match_icmp_with_probe(buf, len, src_ip, dst_ip, src_port, dst_port);
+                    stage_clock.lap(Stage::Match);
+                    metrics_count(matched ? Counter::MatchHit : Counter::MatchMiss);
+                    if (matched) {
                         struct timespec t_recv;
                         clock_gettime(CLOCK_MONOTONIC, &t_recv);
                         double ms = timespec_diff_ms(t_send, t_recv);
                         rtts.push_back(ms);
                         if (hop_ip == "-") hop_ip = std::string(from_s);
+                        got_reply = true;
                         // continue waiting for potential TCP responses
                         
                         struct iphdr *outer_iph = (struct iphdr*)buf;
@@ -196,9 +219,14 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
                 sockaddr_in from{};
                 socklen_t fromlen = sizeof(from);
                 ssize_t len = recvfrom(recv_tcp_sock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromlen);
+                stage_clock.lap(Stage::Receive);
+                if (len < 0) metrics_count(Counter::RecvErrors);
                 if (len > 0) {
                     bool is_dest = false;
-                    if (match_tcp_with_probe(buf, len, src_ip, dst_ip, src_port, dst_port, is_dest)) {
+                    bool matched = match_tcp_with_probe(buf, len, src_ip, dst_ip, src_port, dst_port, is_dest);
+                    stage_clock.lap(Stage::Match);
+                    metrics_count(matched ? Counter::MatchHit : Counter::MatchMiss);
+                    if (matched) {
                         // std::cout << "MATCH TCP\n";
                         struct timespec t_recv;
                         clock_gettime(CLOCK_MONOTONIC, &t_recv);
@@ -208,14 +236,16 @@ bool probe_ttl(int send_sock, int recv_icmp_sock, int recv_tcp_sock,
                         inet_ntop(AF_INET, &from.sin_addr, from_s, sizeof(from_s));
                         if (hop_ip == "-") hop_ip = std::string(from_s);
                         probe_answered = true;
+                        got_reply = true;
                         if (is_dest) destination_reached = true; // SYN-ACK or RST: destination reached
                     } 
                 }
             }
         }
 
-        if (!probe_answered) {
+        if (!got_reply) {
             // record as timeout (-1)
+            metrics_count(Counter::ProbeTimeouts);
             rtts.push_back(-1.0);
         }
     }
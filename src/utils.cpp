@@ -3,6 +3,8 @@
 #include <vector>
 #include <iomanip>
 #include <numeric>
+#include <algorithm>
+#include <string>
 
 double timespec_diff_ms(const struct timespec &a, const struct timespec &b) {
     // returns (b - a) in ms